@@ -2,14 +2,19 @@
 #include <fcntl.h>
 #include <math.h>
 #include <pthread.h>
+#include <poll.h>
 #include <semaphore.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/termios.h>
+#include <sys/un.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
@@ -23,9 +28,24 @@
 #define PERIOD_MULTIPL 1000000
 #define DEF_TERMINAL_WIDTH 100
 #define DEF_TERMINAL_HEIGHT 100
+#define DEF_CHARACTER_WIDTH 8   /*Virtual character pixel size when the terminal reports none*/
+#define DEF_CHARACTER_HEIGHT 16
 #define X_START_OFF 20
 #define Y_START_OFF 20
 #define INPUT_BUF_DIM 100
+#define CLEAN_SCREEN_ESC "\033_Ga=d,d=a\033\\" /*Deletes all visible placements*/
+#define OUTPUT_BUF_BIRD 300    /*Output buffer bytes reserved for every bird escape sequence*/
+#define BIRDS_CHUNK 1024       /*Bird slots allocated at once*/
+#define DEF_WORLD_WIDTH 1920   /*Daemon world size in pixels, viewers scale it to their screen*/
+#define DEF_WORLD_HEIGHT 1080
+#define FRAME_RING 8           /*Number of published frames kept for lagging viewers*/
+#define MAX_VIEWERS 64
+#define VIEWER_HELLO 0x01      /*Sent by a client to receive frames, others only control*/
+#define FRAME_MAGIC 0x52464243 /*"CBFR" little endian*/
+#define FRAME_HEADER_LEN 20    /*magic seq world width, heigth birds predators, see "Headless daemon and viewers"*/
+#define FRAME_RECORD_LEN 5     /*x(i16) y(i16) rotation frame id(u8)*/
+#define OUTPUT_BUF_CELL 20     /*Text renderer bytes reserved for every cell: cursor move + glyph*/
+#define BRAILLE_BASE 0x2800    /*Blank braille pattern, dots are bits added to it*/
 
 /*=========================== Simulation parameters ===============================*/
 
@@ -40,6 +60,9 @@ const double separation_st = 0.001;
 const double cohesion_st = 0.002;
 const int frame_rate_st = 5;
 const int perception_radius_st = 3;
+const double flee_st = 0.2;
+const int birds_st = 100;
+const int birds_big_st = 1000;
 
 const double boundary_av_min = 0.01;
 const double alignment_min = 0.1;
@@ -61,10 +84,21 @@ double SEPARATION_W = 0.005;
 double ALIGNMENT_W = 1.5;
 double COHESION_W = 0.01;
 double BOUNDARY_AV_W = 0.2;
+double FLEE_W = 3.0; /*Steering away from the predators within FLEE_RADIUS*/
+
+/*Predators chase the nearest cluster of boids, boids flee from them*/
+int PREDATORS_N = 0;                     /*Predators number*/
+const double PREDATOR_SPEED_MULT = 1.3;  /*Predator speed relative to boids one*/
+const int PREDATOR_SIZE_OFF = 10;        /*Predator sprite size increment over BIRD_SIZE*/
+const int PREDATOR_PERCEPTION_RADIUS = 200; /*Distance whereas a predator sees a cluster*/
+const double PREDATOR_INERTIA = 2.0;     /*Weight of the current heading while chasing*/
+const int FLEE_RADIUS = 80;              /*Distance whereas a boid sees a predator*/
 
 /*=================================================================================*/
 
 static enum { RESET, RAW } ttystate = RESET; /*Terminal state : RAW, NORMAL*/
+static enum { STANDALONE, DAEMON, VIEWER } run_mode = STANDALONE;
+static enum { KITTY, TEXT } renderer = KITTY;
 
 typedef int rotation_frame_id_t; /*The index that defines the id of the rotation frame*/
 
@@ -83,9 +117,86 @@ typedef struct {
     bird_t *bird_ref;
 } drawn_bird_t;
 
+/*Storage of a bird: its state, the copy the update reads and its drawing data*/
+typedef struct bird_slot {
+    bird_t bird;
+    bird_t copy;
+    drawn_bird_t drawn;
+    struct bird_slot *next_free; /*Free list link*/
+} bird_slot_t;
+
+/* Pool of bird slots. Slots are allocated BIRDS_CHUNK at a time and never
+ * move, removed birds give their slot back to the free list where new birds
+ * take it first. The live birds are compacted at the front of the arrays
+ * below, which only hold pointers and grow geometrically: adding or removing
+ * birds never moves nor reallocates the birds themselves.
+ * */
+typedef struct {
+    bird_slot_t **slots;       /*Live birds slots, BIRDS_N of them*/
+    drawn_bird_t **draw_birds; /*Live birds views used by the simulation*/
+    bird_t **birds;
+    bird_t **birds_copy;
+    bird_t **close;          /*Neighbours of the bird being updated*/
+    int cap;                 /*Capacity of the arrays above*/
+    int slots_n;             /*Slots allocated so far, used as bird ids*/
+    bird_slot_t *free_slots; /*Free list*/
+} flock_t;
+
+/*Uniform grid bucketing predators by FLEE_RADIUS sized cells, a boid only
+ * looks at the 3x3 cells around its own*/
+typedef struct {
+    int cols, rows, cells_cap, next_cap;
+    int *head; /*First predator of every cell, -1 if empty*/
+    int *next; /*Next predator within the same cell*/
+} spatial_index_t;
+
+/*Text cells renderer state. Cells hold unicode code points, 0 is blank*/
+typedef struct {
+    int cols, rows;
+    uint32_t *base;  /*Terminal cells before the frame waiting in the output queue*/
+    uint32_t *shown; /*Terminal cells once the output queue is written*/
+    uint32_t *next;  /*Cells of the frame being drawn*/
+    uint16_t *count; /*Birds within every cell of the frame being drawn*/
+    uint8_t *dots;   /*Braille dots of every cell of the frame being drawn*/
+    char *buf;
+} text_grid_t;
+
+/*Terminal output queue buffer*/
+typedef struct {
+    char *data;
+    size_t len, off, cap;
+    size_t sticky;  /*Leading bytes that can't be dropped*/
+    bool has_frame; /*A frame follows the sticky bytes*/
+} out_buf_t;
+
+/*Published frame, shared by every viewer and recycled once nobody references it*/
+typedef struct frame {
+    uint32_t seq;
+    size_t len, cap;
+    int refs;
+    uint8_t *data;
+    struct frame *next; /*Free list link*/
+} frame_t;
+
+typedef struct {
+    int fd;
+    frame_t *frame; /*Frame being sent, referenced until completely written*/
+    size_t off;     /*Bytes of frame already written*/
+    uint32_t next_seq;
+    bool frames; /*Sent VIEWER_HELLO, a control only client otherwise*/
+} viewer_t;
+
 /*base16 to base64 lookup*/
 const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+/*Text renderer glyphs for every 45 degrees, starting right and turning clockwise (y grows
+ * downwards): single birds and predators*/
+const uint32_t bird_arrows[] = {0x2192, 0x2198, 0x2193, 0x2199, 0x2190, 0x2196, 0x2191, 0x2197};
+const uint32_t predator_arrows[] = {0x21D2, 0x21D8, 0x21D3, 0x21D9,
+                                    0x21D0, 0x21D6, 0x21D1, 0x21D7};
+/*Braille dot bit of every 2x4 sub cell position, indexed by [row][col]*/
+const uint8_t braille_dots[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+
 int max_payload_len = -1;
 ssize_t screen_width;
 ssize_t screen_heigth;
@@ -95,13 +206,33 @@ ssize_t character_width_p;  /*character pixel width*/
 ssize_t character_height_p; /*character pixel heigth*/
 int output_buf_off = 0; /*Offset within the outbuffer used to concatenate escape control strings*/
 struct termios saved_termios; /*Saved termios structure to be resumed after process termination*/
+int saved_stdout_flags = -1; /*Stdout flags to be resumed after process termination*/
+out_buf_t out_inflight;      /*Output being written to the terminal*/
+out_buf_t out_queued;        /*Output waiting for the in flight one to be written*/
+flock_t flock;
+drawn_bird_t **draw_predators;
+bird_t **predators;
+bird_t **predators_copy;
+spatial_index_t predator_index;
+text_grid_t text_grid;
+unsigned long drawn_frames = 0;
+unsigned long dropped_frames = 0; /*Frames replaced by newer ones before reaching the terminal*/
+char *socket_path = NULL;     /*Daemon unix socket, used by both daemon and viewers*/
+frame_t *frame_ring[FRAME_RING];
+frame_t *free_frames = NULL;
+uint32_t frame_seq = 0; /*Sequence number of the next published frame*/
+viewer_t viewers[MAX_VIEWERS];
+int viewers_n = 0;
+char forward_keys[INPUT_BUF_DIM]; /*Viewer keys waiting for the daemon socket to be writable*/
+size_t forward_keys_n = 0;
+volatile sig_atomic_t daemon_running = 1;
 
 /*============================================================================================*/
 
-bird_t *init_bird(int id, int width, int heigth, int screen_width, int screen_heigth);
+void init_bird(bird_t *bird, int id, int width, int heigth, int screen_width, int screen_heigth);
 
-double calculate_rules_direction(bird_t *bird, bird_t **birds, int num_birds, int screen_width,
-                                 int screen_heigth);
+double calculate_rules_direction(bird_t *bird, bird_t **birds, int num_birds, vector2d_t flee,
+                                 int screen_width, int screen_heigth);
 double my_atan2(double y, double x);
 
 int to_degrees(double radians);
@@ -109,21 +240,42 @@ int distance(bird_t *b1, bird_t *b2);
 int squared_distance(bird_t *b1, bird_t *b2);
 int enable_raw_mode();
 int my_atenter();
+int open_server_socket(const char *path);
+int connect_daemon(const char *path);
+int flush_viewer(viewer_t *viewer);
+int read_viewer_input(viewer_t *viewer);
 
 uint8_t *base64_encode(const uint8_t *input, size_t input_length);
 
 vector2d_t calculate_boundary_av_direction(bird_t *bird, int screen_width, int screen_heigth);
+bool calculate_flee_direction(bird_t *bird, bird_t **predators, vector2d_t *flee);
 
 void init_rotation_frames(uint8_t **images_data_array);
 void get_image_path(char *base_path, int size_index, int rotation_frame_id);
-void init_birds(drawn_bird_t **birds_array, uint8_t **images_data_array, int screen_width,
-                int screen_heigth);
+void add_birds(int birds_num);
+void remove_birds(int birds_num);
+void remove_bird(int bird_no);
+void reserve_output(char **output_buf, size_t *output_buf_cap, size_t records_num);
 void display_birds(drawn_bird_t **birds_array, uint8_t **images_data_array, char *output_buf);
 void clean_screen();
 void print_bird(drawn_bird_t **birds_array, int bird_no, char *output_buf);
-void update_rotation_frame_id(drawn_bird_t **birds_array);
-void init(char **output_buf, uint8_t **images_data, drawn_bird_t **draw_birds, bird_t **birds,
-          bird_t **birds_copy);
+void emit_placement(double x, double y, rotation_frame_id_t id, int placement, char *output_buf);
+void begin_frame(char *output_buf);
+void draw(double x, double y, rotation_frame_id_t id, bool predator, int placement,
+          char *output_buf);
+void end_frame(char *output_buf);
+void text_begin_frame();
+void text_plot(double x, double y, rotation_frame_id_t id, bool predator);
+int text_move_right(char *out, int row, int from, int to);
+int text_move_down(char *out, int rows);
+int text_move(char *out, int row, int col, int cursor_row, int cursor_col);
+void text_end_frame();
+void update_rotation_frame_id(drawn_bird_t **birds_array, int birds_num);
+void init_predators(int screen_width, int screen_heigth);
+void build_predator_index(bird_t **predators, int predators_num);
+void update_predators(bird_t **birds, int birds_num, bird_t **predators_to_write,
+                      int predators_num);
+void init(uint8_t **images_data);
 void send_payload_data(uint8_t **payload_data);
 void get_screen_dimensions();
 void fix_weights();
@@ -136,8 +288,25 @@ void init_vector(vector2d_t *vector, double x, double y);
 void close_birds(bird_t **close_birds_list, bird_t *target, bird_t **birds, int num_birds,
                  int *counter);
 void my_atexit();
-void refresh_screen();
-void handle_key(uint8_t **images_data);
+void out_write(const char *data, size_t len);
+void out_frame(const char *data, size_t len);
+size_t out_flush();
+bool out_frame_pending();
+void out_drain();
+void wait_frame(long period_us);
+void append_output(char *output_buf, const char *data);
+void refresh_screen(char **output_buf, size_t *output_buf_cap);
+void handle_key(uint8_t **images_data, int daemon_fd);
+int flush_keys(int daemon_fd);
+void apply_key(char c, uint8_t **images_data);
+void simulate(drawn_bird_t **draw_birds, bird_t **birds, bird_t **birds_copy);
+void publish_frame(drawn_bird_t **draw_birds);
+void release_frame(frame_t *frame);
+void accept_viewers(int listen_fd);
+void drop_viewer(int viewer_no);
+void run_daemon();
+void run_viewer(uint8_t **images_data);
+void render_frame(const uint8_t *frame, char **output_buf, size_t *output_buf_cap);
 void read_input(int argc, char **argv);
 void change_birds_dimensions(bool increase, uint8_t **bird_images);
 
@@ -145,24 +314,46 @@ void change_birds_dimensions(bool increase, uint8_t **bird_images);
 
 void get_screen_dimensions() {
     struct winsize w;
+    if (run_mode == DAEMON) { /*Headless: the world has a fixed size*/
+        screen_width = DEF_WORLD_WIDTH;
+        screen_heigth = DEF_WORLD_HEIGHT;
+        fix_weights();
+        return;
+    }
     ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
     screen_width = w.ws_xpixel;
     screen_heigth = w.ws_ypixel;
     n_col = w.ws_col;
     n_row = w.ws_row;
-    character_width_p = (double)screen_width / n_col;
-    character_height_p = (double)screen_heigth / n_row;
     if (!screen_heigth || !screen_width) {
-        screen_heigth = DEF_TERMINAL_HEIGHT;
-        screen_width = DEF_TERMINAL_WIDTH;
+        /*No pixel size reported, e.g. terminals without graphics: virtual pixels*/
+        if (!n_col || !n_row) {
+            n_col = DEF_TERMINAL_WIDTH / DEF_CHARACTER_WIDTH;
+            n_row = DEF_TERMINAL_HEIGHT / DEF_CHARACTER_HEIGHT;
+        }
+        screen_width = n_col * DEF_CHARACTER_WIDTH;
+        screen_heigth = n_row * DEF_CHARACTER_HEIGHT;
     }
+    character_width_p = (double)screen_width / n_col;
+    character_height_p = (double)screen_heigth / n_row;
     fix_weights();
 }
 
 int my_atenter() {
     /*Enable alternate buffer*/
     system("tput smcup");
-    return enable_raw_mode();
+    if (enable_raw_mode() < 0) return -1;
+    /*Output is queued and written as the terminal drains it. Set last: exit
+     * callback isn't registered yet if this fails, nothing must be left behind*/
+    saved_stdout_flags = fcntl(STDOUT_FILENO, F_GETFL);
+    if (saved_stdout_flags < 0 ||
+        fcntl(STDOUT_FILENO, F_SETFL, saved_stdout_flags | O_NONBLOCK) < 0) {
+        saved_stdout_flags = -1;
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_termios);
+        ttystate = RESET;
+        return -1;
+    }
+    return 0;
 }
 
 /* Raw mode : 1960 magic shit */
@@ -193,9 +384,129 @@ int enable_raw_mode() {
 }
 
 void my_atexit() {
+    if (ttystate == RESET) return;
+    if (renderer == TEXT) out_write("\033[?25h", strlen("\033[?25h")); /*Shows cursor*/
+    /*Completes the escape in flight, the terminal would be left in the middle of it*/
+    out_drain();
     /*Disable alternate buffer*/
     system("tput rmcup");
     tcsetattr(STDERR_FILENO, TCSAFLUSH, &saved_termios);
+    ttystate = RESET;
+    if (dropped_frames)
+        fprintf(stderr, "%lu of %lu frames dropped, the terminal couldn't keep up\n",
+                dropped_frames, drawn_frames);
+}
+
+/*=========================Non blocking output queue===========================
+ *
+ * Stdout is non blocking, everything sent to the terminal goes through this
+ * queue. The in flight buffer is written as the terminal drains it, the queued
+ * one collects what comes next. Control escapes (payload uploads, deletions)
+ * are never dropped, while a queued frame not yet started is replaced by a
+ * newer one: a slow terminal always receives the newest state instead of
+ * falling behind the simulation. */
+
+void out_reserve(out_buf_t *buf, size_t len) {
+    if (buf->cap < buf->len + len) {
+        buf->cap = (buf->len + len) * 2;
+        buf->data = (char *)realloc(buf->data, buf->cap);
+    }
+}
+
+void out_drop_frame() {
+    if (out_queued.has_frame) {
+        out_queued.len = out_queued.sticky;
+        out_queued.has_frame = false;
+        dropped_frames++;
+    }
+}
+
+/*Queues bytes that must reach the terminal*/
+void out_write(const char *data, size_t len) {
+    out_drop_frame(); /*Control escapes would otherwise follow a stale frame*/
+    out_reserve(&out_queued, len);
+    memcpy(out_queued.data + out_queued.len, data, len);
+    out_queued.len += len;
+    out_queued.sticky = out_queued.len;
+    out_flush();
+}
+
+/*Queues a frame, replacing the one still waiting if any*/
+void out_frame(const char *data, size_t len) {
+    out_drop_frame();
+    out_reserve(&out_queued, len);
+    memcpy(out_queued.data + out_queued.len, data, len);
+    out_queued.len += len;
+    out_queued.has_frame = true;
+    drawn_frames++;
+    out_flush();
+}
+
+/*Whether a frame is waiting, the next one replaces it*/
+bool out_frame_pending() {
+    return out_queued.has_frame;
+}
+
+/*Writes until the terminal would block, returns the bytes still in flight*/
+size_t out_flush() {
+    ssize_t n;
+
+    while (1) {
+        if (out_inflight.off == out_inflight.len) {
+            out_buf_t buf = out_inflight;
+            if (out_queued.len == 0) return 0;
+            out_inflight = out_queued;
+            out_queued = buf;
+            out_queued.len = out_queued.off = out_queued.sticky = 0;
+            out_queued.has_frame = false;
+        }
+        n = write(STDOUT_FILENO, out_inflight.data + out_inflight.off,
+                  out_inflight.len - out_inflight.off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return out_inflight.len - out_inflight.off + out_queued.len;
+            /*The terminal has gone, nothing more can be written*/
+            out_inflight.off = out_inflight.len;
+            out_queued.len = out_queued.sticky = 0;
+            out_queued.has_frame = false;
+            return 0;
+        }
+        out_inflight.off += n;
+    }
+}
+
+/*Blocking write of the pending output, but the queued frame*/
+void out_drain() {
+    if (saved_stdout_flags < 0) return;
+    fcntl(STDOUT_FILENO, F_SETFL, saved_stdout_flags);
+    if (out_queued.has_frame) {
+        out_queued.len = out_queued.sticky;
+        out_queued.has_frame = false;
+    }
+    out_flush();
+}
+
+/*Sleeps up to period_us, writing pending output as soon as the terminal accepts it*/
+void wait_frame(long period_us) {
+    struct timespec now, deadline;
+    struct pollfd fds = {STDOUT_FILENO, POLLOUT, 0};
+    long remaining_us;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += (deadline.tv_nsec / 1000 + period_us) / 1000000;
+    deadline.tv_nsec = (deadline.tv_nsec / 1000 + period_us) % 1000000 * 1000;
+    while (1) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remaining_us = (deadline.tv_sec - now.tv_sec) * 1000000 +
+                       (deadline.tv_nsec - now.tv_nsec) / 1000;
+        if (remaining_us <= 0) return;
+        if (out_flush() == 0 || remaining_us < 1000) {
+            usleep(remaining_us);
+            return;
+        }
+        poll(&fds, 1, remaining_us / 1000);
+    }
 }
 
 //========================Image data manipulation==============================
@@ -314,13 +625,22 @@ void get_image_path(char *base_path, int size_index, int rotation_frame_id) {
  * loop, then position and direction updates are sent for every frame specifying
  * new parameters without sending again the entire payload. */
 
+/* Predators use the rotation frames of a bigger size, uploaded after the birds
+ * ones: their image index is ROTATION_FRAME + rotation frame id.
+ * */
 void send_payload_data(uint8_t **images_data) {
     int image_size_index = BIRD_SIZE - BASE_IMAGE_SIZE;
-    for (int i = 0; i < ROTATION_FRAME; i++) {
-        printf("\033_Ga=t,q=2,f=100,I=%d;%s\033\\", i + 1,
-               (char *)images_data[ROTATION_FRAME * image_size_index + i]);
+    int predator_size_index = image_size_index + PREDATOR_SIZE_OFF;
+    char *buf = (char *)malloc(max_payload_len + 50);
+
+    if (predator_size_index > IMAGE_SIZES - 1) predator_size_index = IMAGE_SIZES - 1;
+    for (int i = 0; i < 2 * ROTATION_FRAME; i++) {
+        int size_index = i < ROTATION_FRAME ? image_size_index : predator_size_index;
+        int len = sprintf(buf, "\033_Ga=t,q=2,f=100,I=%d;%s\033\\", i + 1,
+                          (char *)images_data[ROTATION_FRAME * size_index + i % ROTATION_FRAME]);
+        out_write(buf, len);
     }
-    fflush(stdout);
+    free(buf);
     clean_screen();
 }
 
@@ -330,73 +650,356 @@ void send_payload_data(uint8_t **images_data) {
  * placement_index) assigned to the same image index.
  * */
 void print_bird(drawn_bird_t **birds_array, int bird_no, char *output_buf) {
-    char buf[150];
     drawn_bird_t *bird = birds_array[bird_no];
+    draw(bird->bird_ref->x, bird->bird_ref->y, bird->curr_id, false, bird_no, output_buf);
+}
+
+void begin_frame(char *output_buf) {
+    if (renderer == TEXT)
+        text_begin_frame();
+    else
+        append_output(output_buf, CLEAN_SCREEN_ESC);
+}
+
+/*Draws a bird or a predator with the current renderer*/
+void draw(double x, double y, rotation_frame_id_t id, bool predator, int placement,
+          char *output_buf) {
+    if (renderer == TEXT)
+        text_plot(x, y, id, predator);
+    else
+        emit_placement(x, y, predator ? ROTATION_FRAME + id : id, placement, output_buf);
+}
 
+void end_frame(char *output_buf) {
+    if (renderer == TEXT) {
+        text_end_frame();
+    } else {
+        out_frame(output_buf, output_buf_off);
+        output_buf_off = 0;
+    }
+}
+
+/*Appends the placement of rotation frame id at pixel coordinates x, y*/
+void emit_placement(double x, double y, rotation_frame_id_t id, int placement, char *output_buf) {
+    char buf[150];
     int col, row, offset_x, offset_y;
 
-    col = bird->bird_ref->x / character_width_p;
-    row = bird->bird_ref->y / character_height_p;
-    offset_x = (int)bird->bird_ref->x % character_width_p;
-    offset_y = (int)bird->bird_ref->y % character_height_p;
+    col = x / character_width_p;
+    row = y / character_height_p;
+    offset_x = (int)x % character_width_p;
+    offset_y = (int)y % character_height_p;
 
     if (col >= 0 && col < n_col && row >= 0 && row < n_row) {
-        rotation_frame_id_t id = bird->curr_id;
         sprintf(buf, "\033[%d;%dH\033_Ga=p,I=%d,q=2,p=%d,X=%d,Y=%d,z=%d\033\\", row + 1, col + 1,
-                id + 1, 0, offset_x, offset_y, bird_no);
-        /*Every escape sequence is concatened to the outpute buffer that is
-         * flushed output once a frame*/
-        memcpy(output_buf + output_buf_off, buf, strlen(buf));
-        output_buf_off += strlen(buf);
+                id + 1, 0, offset_x, offset_y, placement);
+        append_output(output_buf, buf);
     }
 }
 
+/*Every escape sequence is concatened to the outpute buffer that is queued
+ * once a frame*/
+void append_output(char *output_buf, const char *data) {
+    size_t len = strlen(data);
+    memcpy(output_buf + output_buf_off, data, len);
+    output_buf_off += len;
+}
+
 /*Deletes all visible placements*/
 void clean_screen() {
-    printf("\033_Ga=d,d=a\033\\");
+    out_write(CLEAN_SCREEN_ESC, strlen(CLEAN_SCREEN_ESC));
 }
 
 /*Deletes every cached placement*/
 void delete_placements() {
-    printf("\033_Ga=d,d=A\033\\");
+    out_write("\033_Ga=d,d=A\033\\", strlen("\033_Ga=d,d=A\033\\"));
+}
+
+/*=========================Text cells renderer================================
+ *
+ * Fallback for terminals without graphics and for slow links. Birds are
+ * rasterized into the character cells: a single bird is an arrow pointing to
+ * its direction, crowded cells show the braille dots of their birds, predators
+ * are double arrows drawn over birds. The cells the terminal shows are kept,
+ * only the changed ones are written, so bytes per frame follow motion instead
+ * of birds number.
+ *
+ * A frame waiting in the output queue is replaced by the next one, so it's
+ * diffed against the cells before the waiting frame. */
+
+int utf8_encode(uint32_t code_point, char *out) {
+    if (code_point == 0) { /*Blank*/
+        out[0] = ' ';
+        return 1;
+    }
+    if (code_point < 0x80) {
+        out[0] = code_point;
+        return 1;
+    }
+    if (code_point < 0x800) {
+        out[0] = 0xc0 | code_point >> 6;
+        out[1] = 0x80 | (code_point & 0x3f);
+        return 2;
+    }
+    out[0] = 0xe0 | code_point >> 12;
+    out[1] = 0x80 | (code_point >> 6 & 0x3f);
+    out[2] = 0x80 | (code_point & 0x3f);
+    return 3;
+}
+
+void text_begin_frame() {
+    text_grid_t *grid = &text_grid;
+    size_t cells;
+
+    if (grid->cols != n_col || grid->rows != n_row) { /*Resized: everything is redrawn*/
+        grid->cols = n_col;
+        grid->rows = n_row;
+        cells = (size_t)n_col * n_row;
+        grid->base = (uint32_t *)realloc(grid->base, sizeof(uint32_t) * cells);
+        grid->shown = (uint32_t *)realloc(grid->shown, sizeof(uint32_t) * cells);
+        grid->next = (uint32_t *)realloc(grid->next, sizeof(uint32_t) * cells);
+        grid->count = (uint16_t *)realloc(grid->count, sizeof(uint16_t) * cells);
+        grid->dots = (uint8_t *)realloc(grid->dots, cells);
+        grid->buf = (char *)realloc(grid->buf, OUTPUT_BUF_CELL * (cells + 1));
+        memset(grid->base, 0, sizeof(uint32_t) * cells);
+        memset(grid->shown, 0, sizeof(uint32_t) * cells);
+        /*Never dropped, unlike the frame: it also drops any waiting frame, so
+         * the terminal is blank as both grids*/
+        out_write("\033[2J", strlen("\033[2J"));
+    }
+    cells = (size_t)grid->cols * grid->rows;
+    memset(grid->next, 0, sizeof(uint32_t) * cells);
+    memset(grid->count, 0, sizeof(uint16_t) * cells);
+    memset(grid->dots, 0, cells);
+}
+
+void text_plot(double x, double y, rotation_frame_id_t id, bool predator) {
+    text_grid_t *grid = &text_grid;
+    int col, row, cell, direction;
+
+    if (x < 0 || y < 0) return;
+    col = x / character_width_p;
+    row = y / character_height_p;
+    if (col >= grid->cols || row >= grid->rows) return;
+    cell = row * grid->cols + col;
+    direction = (id * FRAME_ANGLE + 22) / 45 % 8;
+
+    if (predator) {
+        grid->next[cell] = predator_arrows[direction];
+        grid->count[cell] = UINT16_MAX; /*Birds can't cover it*/
+        return;
+    }
+    if (grid->count[cell] == UINT16_MAX) return;
+    grid->count[cell]++;
+    grid->dots[cell] |= braille_dots[(int)(fmod(y, character_height_p) * 4 / character_height_p)]
+                                    [(int)(fmod(x, character_width_p) * 2 / character_width_p)];
+    grid->next[cell] =
+        grid->count[cell] == 1 ? bird_arrows[direction] : BRAILLE_BASE | grid->dots[cell];
+}
+
+/* Moves right within a row, rewriting the unchanged cells in between when it's
+ * cheaper than moving*/
+int text_move_right(char *out, int row, int from, int to) {
+    text_grid_t *grid = &text_grid;
+    char rewrite[OUTPUT_BUF_CELL];
+    int move_len, rewrite_len = 0;
+
+    if (to <= from) return 0;
+    move_len = sprintf(out, "\033[%dC", to - from);
+    for (int i = from; i < to && rewrite_len <= move_len; i++)
+        rewrite_len += utf8_encode(grid->next[row * grid->cols + i], rewrite);
+    if (rewrite_len > move_len) return move_len;
+    rewrite_len = 0;
+    for (int i = from; i < to; i++)
+        rewrite_len += utf8_encode(grid->next[row * grid->cols + i], out + rewrite_len);
+    return rewrite_len;
+}
+
+/*Moves down keeping the column, line feeds don't return carriage without OPOST*/
+int text_move_down(char *out, int rows) {
+    if (rows < 4) {
+        memset(out, '\n', rows);
+        return rows;
+    }
+    return sprintf(out, "\033[%dB", rows);
+}
+
+/* Writes the shortest cursor move to a cell after the cursor in the diff order:
+ * absolute, down then sideways, or to the row start (CR or CNL) then right.
+ * An unknown cursor position (-1) takes the absolute move.*/
+int text_move(char *out, int row, int col, int cursor_row, int cursor_col) {
+    char move[OUTPUT_BUF_CELL * 2];
+    int len = sprintf(out, "\033[%d;%dH", row + 1, col + 1);
+    int move_len, down = row - cursor_row;
+
+    if (cursor_row < 0 || down < 0 || (down == 0 && col < cursor_col)) return len;
+
+    move_len = text_move_down(move, down);
+    if (col >= cursor_col)
+        move_len += text_move_right(move + move_len, row, cursor_col, col);
+    else
+        move_len += sprintf(move + move_len, "\033[%dD", cursor_col - col);
+    if (move_len < len) {
+        memcpy(out, move, move_len);
+        len = move_len;
+    }
+
+    if (down >= 4) {
+        move_len = sprintf(move, "\033[%dE", down);
+    } else {
+        move[0] = '\r';
+        move_len = 1 + text_move_down(move + 1, down);
+    }
+    move_len += text_move_right(move + move_len, row, 0, col);
+    if (move_len < len) {
+        memcpy(out, move, move_len);
+        len = move_len;
+    }
+    return len;
+}
+
+/*Writes the changed cells moving the cursor as little as possible*/
+void text_end_frame() {
+    text_grid_t *grid = &text_grid;
+    bool replacing = out_frame_pending();
+    uint32_t *base = replacing ? grid->base : grid->shown;
+    uint32_t *swap;
+    int cursor_row = -1, cursor_col = -1; /*Unknown cursor position*/
+    int off = 0;
+
+    for (int row = 0; row < grid->rows; row++) {
+        for (int col = 0; col < grid->cols; col++) {
+            int cell = row * grid->cols + col;
+            if (grid->next[cell] == base[cell]) continue;
+
+            if (row != cursor_row || col != cursor_col)
+                off += text_move(grid->buf + off, row, col, cursor_row, cursor_col);
+            off += utf8_encode(grid->next[cell], grid->buf + off);
+            cursor_row = row;
+            cursor_col = col + 1;
+            if (cursor_col == grid->cols) cursor_row = -1; /*Pending wrap*/
+        }
+    }
+
+    /*The waiting frame is dropped, its cells with it*/
+    if (replacing) {
+        swap = grid->shown;
+        grid->shown = grid->next;
+    } else {
+        swap = grid->base;
+        grid->base = grid->shown;
+        grid->shown = grid->next;
+    }
+    grid->next = swap;
+    out_frame(grid->buf, off); /*Even if empty, it replaces the waiting frame*/
 }
 
 /*=======================Birds behaviour logic==========================*/
 
-void init(char **output_buf, uint8_t **images_data, drawn_bird_t **draw_birds, bird_t **birds,
-          bird_t **birds_copy) {
-    ssize_t buffer_offset = 300;
+void init(uint8_t **images_data) {
+    int birds_num = BIRDS_N;
+
     get_screen_dimensions();
-    *output_buf = (char *)malloc(sizeof(char) * (buffer_offset)*BIRDS_N + 1);
-    *output_buf[0] = '\0';
-    for (int i = 0; i < BIRDS_N; i++) {
-        draw_birds[i] = (drawn_bird_t *)malloc(sizeof(drawn_bird_t));
-        birds_copy[i] = (bird_t *)malloc(sizeof(bird_t));
+    BIRDS_N = 0;
+    add_birds(birds_num);
+    if (images_data) init_rotation_frames(images_data); /*Daemon and text draw no sprites*/
+    init_predators(screen_width, screen_heigth);
+}
+
+void init_predators(int screen_width, int screen_heigth) {
+    int predator_size = BIRD_SIZE + PREDATOR_SIZE_OFF;
+
+    draw_predators = (drawn_bird_t **)malloc(sizeof(drawn_bird_t *) * PREDATORS_N);
+    predators = (bird_t **)malloc(sizeof(bird_t *) * PREDATORS_N);
+    predators_copy = (bird_t **)malloc(sizeof(bird_t *) * PREDATORS_N);
+    for (int i = 0; i < PREDATORS_N; i++) {
+        predators[i] = (bird_t *)malloc(sizeof(bird_t));
+        init_bird(predators[i], i, predator_size, predator_size, screen_width, screen_heigth);
+        predators[i]->speed = SPEED * PREDATOR_SPEED_MULT;
+        predators_copy[i] = (bird_t *)malloc(sizeof(bird_t));
+        draw_predators[i] = (drawn_bird_t *)malloc(sizeof(drawn_bird_t));
+        draw_predators[i]->bird_ref = predators[i];
+        draw_predators[i]->curr_id = to_degrees(predators[i]->direction) / FRAME_ANGLE;
+        draw_predators[i]->prev_id = draw_predators[i]->curr_id;
     }
+}
+
+/*Grows the live birds arrays to hold at least birds_num birds*/
+void reserve_birds(int birds_num) {
+    flock_t *f = &flock;
+
+    if (f->cap >= birds_num) return;
+    f->cap = f->cap * 2 > birds_num ? f->cap * 2 : birds_num;
+    f->slots = (bird_slot_t **)realloc(f->slots, sizeof(bird_slot_t *) * f->cap);
+    f->draw_birds = (drawn_bird_t **)realloc(f->draw_birds, sizeof(drawn_bird_t *) * f->cap);
+    f->birds = (bird_t **)realloc(f->birds, sizeof(bird_t *) * f->cap);
+    f->birds_copy = (bird_t **)realloc(f->birds_copy, sizeof(bird_t *) * f->cap);
+    f->close = (bird_t **)realloc(f->close, sizeof(bird_t *) * f->cap);
+}
 
-    init_birds(draw_birds, images_data, screen_width, screen_heigth);
-    for (int i = 0; i < BIRDS_N; i++) {
-        birds[i] = draw_birds[i]->bird_ref;
+/*Allocates a chunk of slots and puts them in the free list*/
+void add_slots_chunk() {
+    flock_t *f = &flock;
+    bird_slot_t *chunk = (bird_slot_t *)malloc(sizeof(bird_slot_t) * BIRDS_CHUNK);
+
+    if (chunk == NULL) {
+        perror("Can't allocate birds");
+        exit(-1);
+    }
+    for (int i = BIRDS_CHUNK - 1; i >= 0; i--) {
+        chunk[i].bird.id = f->slots_n + i; /*Ids are unique for the whole process life*/
+        chunk[i].next_free = f->free_slots;
+        f->free_slots = &chunk[i];
     }
+    f->slots_n += BIRDS_CHUNK;
 }
 
-void init_birds(drawn_bird_t **birds_array, uint8_t **images_data_array, int screen_width,
-                int screen_heigth) {
-    for (int i = 0; i < BIRDS_N; i++) {
-        birds_array[i]->bird_ref = init_bird(i, BIRD_SIZE, BIRD_SIZE, screen_width, screen_heigth);
-        birds_array[i]->curr_id = to_degrees(birds_array[i]->bird_ref->direction) / FRAME_ANGLE;
-        birds_array[i]->prev_id = birds_array[i]->curr_id;
+/*Adds birds at random positions*/
+void add_birds(int birds_num) {
+    flock_t *f = &flock;
+
+    reserve_birds(BIRDS_N + birds_num);
+    for (int i = 0; i < birds_num; i++) {
+        bird_slot_t *slot;
+        if (f->free_slots == NULL) add_slots_chunk();
+        slot = f->free_slots;
+        f->free_slots = slot->next_free;
+
+        init_bird(&slot->bird, slot->bird.id, BIRD_SIZE, BIRD_SIZE, screen_width, screen_heigth);
+        slot->drawn.bird_ref = &slot->bird;
+        slot->drawn.curr_id = to_degrees(slot->bird.direction) / FRAME_ANGLE;
+        slot->drawn.prev_id = slot->drawn.curr_id;
+        f->slots[BIRDS_N] = slot;
+        f->draw_birds[BIRDS_N] = &slot->drawn;
+        f->birds[BIRDS_N] = &slot->bird;
+        f->birds_copy[BIRDS_N] = &slot->copy;
+        BIRDS_N++;
     }
-    init_rotation_frames(images_data_array);
+}
+
+/*Removes a bird moving the last one in its place*/
+void remove_bird(int bird_no) {
+    flock_t *f = &flock;
+    int last = --BIRDS_N;
+
+    f->slots[bird_no]->next_free = f->free_slots;
+    f->free_slots = f->slots[bird_no];
+    f->slots[bird_no] = f->slots[last];
+    f->draw_birds[bird_no] = f->draw_birds[last];
+    f->birds[bird_no] = f->birds[last];
+    f->birds_copy[bird_no] = f->birds_copy[last];
+}
+
+/*Removes the newest birds, at least one is kept*/
+void remove_birds(int birds_num) {
+    if (birds_num > BIRDS_N - 1) birds_num = BIRDS_N - 1;
+    for (int i = 0; i < birds_num; i++) remove_bird(BIRDS_N - 1);
 }
 
 /**
  * Bird constructor. Initializes bird direction, x and y coordinates as random
  * values.
  */
-bird_t *init_bird(int id, int width, int heigth, int screen_width, int screen_heigth) {
-    bird_t *bird = (bird_t *)malloc(sizeof(bird_t));
-
+void init_bird(bird_t *bird, int id, int width, int heigth, int screen_width, int screen_heigth) {
     bird->x = screen_width * ((double)rand() / RAND_MAX) + X_START_OFF;
     bird->y = screen_heigth * ((double)rand() / RAND_MAX) + Y_START_OFF;
     bird->direction = 2 * M_PI * ((double)rand() / RAND_MAX);
@@ -410,27 +1013,107 @@ bird_t *init_bird(int id, int width, int heigth, int screen_width, int screen_he
         bird->x = screen_width / 2;
     if (bird->y < TURN_RADIUS_Y || bird->y > screen_heigth - TURN_RADIUS_Y)
         bird->y = screen_heigth / 2;
+}
+
+/*Grid coordinate of position, out of screen positions fall in border cells*/
+int grid_coord(double position, int cells) {
+    int coord = (int)floor(position / FLEE_RADIUS);
+    if (coord < 0) return 0;
+    if (coord >= cells) return cells - 1;
+    return coord;
+}
 
-    return bird;
+int grid_cell(spatial_index_t *index, double x, double y) {
+    return grid_coord(y, index->rows) * index->cols + grid_coord(x, index->cols);
 }
 
 void update_birds(bird_t **birds_copy_to_read, bird_t **birds_to_write, int screen_width,
                   int screen_height, int birds_num) {
     for (int i = 0; i < birds_num; i++) {
         int counter = 0;
-        bird_t *close[birds_num];
+        bird_t **close = flock.close;
+        vector2d_t flee;
+        bool fleeing = calculate_flee_direction(birds_copy_to_read[i], predators_copy, &flee);
         close_birds(close, birds_copy_to_read[i], birds_copy_to_read, birds_num, &counter);
-        if (counter > 0) {
+        if (counter > 0 || fleeing) {
             double direction = calculate_rules_direction(birds_copy_to_read[i], close, counter,
-                                                         screen_width, screen_height);
+                                                         flee, screen_width, screen_height);
             update_direction(birds_to_write[i], direction);
         }
     }
 }
 
+/**
+ * Steers every predator towards the nearest cluster: the center of mass of the
+ * boids within its perception radius or, if it sees none, the nearest boid.
+ * A single pass over the boids for each predator, their number is small.
+ */
+void update_predators(bird_t **birds, int birds_num, bird_t **predators_to_write,
+                      int predators_num) {
+    int perception_squared = PREDATOR_PERCEPTION_RADIUS * PREDATOR_PERCEPTION_RADIUS;
+
+    for (int i = 0; i < predators_num; i++) {
+        bird_t *predator = predators_copy[i];
+        bird_t *nearest = NULL;
+        int nearest_distance = 0;
+        int close_count = 0;
+        vector2d_t cluster = {0, 0};
+        vector2d_t chase = {0, 0};
+        vector2d_t boundary_av =
+            calculate_boundary_av_direction(predator, screen_width, screen_heigth);
+
+        for (int j = 0; j < birds_num; j++) {
+            int d = squared_distance(predator, birds[j]);
+            if (nearest == NULL || d < nearest_distance) {
+                nearest = birds[j];
+                nearest_distance = d;
+            }
+            if (d < perception_squared) {
+                add_vector(&cluster, birds[j]->x, birds[j]->y);
+                close_count++;
+            }
+        }
+        if (close_count > 0) {
+            init_vector(&chase, cluster.x / close_count - predator->x,
+                        cluster.y / close_count - predator->y);
+        } else if (nearest != NULL) {
+            init_vector(&chase, nearest->x - predator->x, nearest->y - predator->y);
+        }
+        if (chase.x != 0 || chase.y != 0) prod_vector(&chase, 1 / hypot(chase.x, chase.y));
+
+        double result_x = PREDATOR_INERTIA * cos(predator->direction) + chase.x + boundary_av.x;
+        double result_y = PREDATOR_INERTIA * sin(predator->direction) + chase.y + boundary_av.y;
+        update_direction(predators_to_write[i], my_atan2(result_y, result_x));
+    }
+}
+
+/*Rebuilds the predators grid on the immutable copy of their state*/
+void build_predator_index(bird_t **predators, int predators_num) {
+    spatial_index_t *index = &predator_index;
+    int cells;
+
+    index->cols = screen_width / FLEE_RADIUS + 1;
+    index->rows = screen_heigth / FLEE_RADIUS + 1;
+    cells = index->cols * index->rows;
+    if (index->cells_cap < cells) {
+        index->head = (int *)realloc(index->head, sizeof(int) * cells);
+        index->cells_cap = cells;
+    }
+    if (index->next_cap < predators_num) {
+        index->next = (int *)realloc(index->next, sizeof(int) * predators_num);
+        index->next_cap = predators_num;
+    }
+    for (int i = 0; i < cells; i++) index->head[i] = -1;
+    for (int i = 0; i < predators_num; i++) {
+        int cell = grid_cell(index, predators[i]->x, predators[i]->y);
+        index->next[i] = index->head[cell];
+        index->head[cell] = i;
+    }
+}
+
 /*Updates the bird frame_id according to his new direction*/
-void update_rotation_frame_id(drawn_bird_t **birds_array) {
-    for (int i = 0; i < BIRDS_N; i++) {
+void update_rotation_frame_id(drawn_bird_t **birds_array, int birds_num) {
+    for (int i = 0; i < birds_num; i++) {
         birds_array[i]->prev_id = birds_array[i]->curr_id;
         birds_array[i]->curr_id = to_degrees(birds_array[i]->bird_ref->direction) / FRAME_ANGLE;
     }
@@ -487,15 +1170,48 @@ vector2d_t calculate_boundary_av_direction(bird_t *bird, int screen_width, int s
 }
 
 /**
- * Calculates the steering vector calculating as the sum of four different ones:
+ * Calculates the steering vector away from the predators closer than
+ * FLEE_RADIUS, each one weighted by its unit direction. Only the predators in
+ * the grid cells around the bird are checked. Returns whether there is any.
+ */
+bool calculate_flee_direction(bird_t *bird, bird_t **predators, vector2d_t *flee) {
+    spatial_index_t *index = &predator_index;
+    int flee_radius_squared = FLEE_RADIUS * FLEE_RADIUS;
+    int col, row;
+    bool found = false;
+
+    init_vector(flee, 0, 0);
+    if (PREDATORS_N == 0) return false;
+    col = grid_coord(bird->x, index->cols);
+    row = grid_coord(bird->y, index->rows);
+    for (int r = row - 1; r <= row + 1; r++) {
+        for (int c = col - 1; c <= col + 1; c++) {
+            if (r < 0 || r >= index->rows || c < 0 || c >= index->cols) continue;
+            for (int i = index->head[r * index->cols + c]; i != -1; i = index->next[i]) {
+                int d = squared_distance(bird, predators[i]);
+                if (d < flee_radius_squared) {
+                    double dist = sqrt(d) + 1;
+                    add_vector(flee, (bird->x - predators[i]->x) / dist,
+                               (bird->y - predators[i]->y) / dist);
+                    found = true;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * Calculates the steering vector calculating as the sum of five different ones:
  *
  * Separation : steer vector to avoid crowding local birds
  * Alignment : steer vector that is the mean of the steer vector of local birds
  * Cohesion : steer vector used to move towards local birds
  * Border avoidance : steer vector used to remain between borders
+ * Flee : steer vector away from close predators
  * */
-double calculate_rules_direction(bird_t *target, bird_t **birds, int num_birds, int screen_width,
-                                 int screen_heigth) {
+double calculate_rules_direction(bird_t *target, bird_t **birds, int num_birds, vector2d_t flee,
+                                 int screen_width, int screen_heigth) {
     vector2d_t separation = {0, 0};
     vector2d_t alignment = {0, 0};
     vector2d_t cohesion = {0, 0};
@@ -533,11 +1249,17 @@ double calculate_rules_direction(bird_t *target, bird_t **birds, int num_birds,
         prod_vector(&alignment, ALIGNMENT_W);
         prod_vector(&cohesion, COHESION_W);
         prod_vector(&boundary_av_ptr, BOUNDARY_AV_W);
+        prod_vector(&flee, FLEE_W);
 
-        double result_x = separation.x + alignment.x + cohesion.x + boundary_av_ptr.x;
-        double result_y = separation.y + alignment.y + cohesion.y + boundary_av_ptr.y;
+        double result_x = separation.x + alignment.x + cohesion.x + boundary_av_ptr.x + flee.x;
+        double result_y = separation.y + alignment.y + cohesion.y + boundary_av_ptr.y + flee.y;
 
         return my_atan2(result_y, result_x);
+    } else if (flee.x != 0 || flee.y != 0) {
+        // A lonely bird only flees
+        prod_vector(&boundary_av_ptr, BOUNDARY_AV_W);
+        prod_vector(&flee, FLEE_W);
+        return my_atan2(flee.y + boundary_av_ptr.y, flee.x + boundary_av_ptr.x);
     } else {
         // If there are no birds nearby simply returns the older direction
         return target->direction;
@@ -556,7 +1278,7 @@ int to_degrees(double radians) {
 }
 
 void clear() {
-    printf("\x1b[J");
+    out_write("\x1b[J", strlen("\x1b[J"));
 }
 
 void init_vector(vector2d_t *vector, double x, double y) {
@@ -608,8 +1330,8 @@ void fix_weights() {
     TURN_RADIUS_Y = screen_heigth / factor;
 }
 
-/*Handles raw mode input keys*/
-void handle_key(uint8_t **images_data) {
+/*Handles raw mode input keys, a viewer forwards simulation keys to the daemon*/
+void handle_key(uint8_t **images_data, int daemon_fd) {
     char input_buf[INPUT_BUF_DIM];
     ssize_t size;
 
@@ -617,59 +1339,109 @@ void handle_key(uint8_t **images_data) {
     if (size == 1) {
         char c = input_buf[0];
 
-        switch (c) {
-            case 'q': /*quit*/
-                my_atexit();
-                exit(0);
-                break;
-            case '=': /*increase bird image size*/
-                if (BIRD_SIZE < IMAGE_SIZES + BASE_IMAGE_SIZE - 1)
-                    change_birds_dimensions(true, images_data);
-                break;
-            case '-': /*decrease bird image size*/
-                if (BIRD_SIZE > BASE_IMAGE_SIZE) change_birds_dimensions(false, images_data);
-                break;
-            case 'B': /*increase boundary_av*/
-                BOUNDARY_AV_W += boundary_av_st;
-                break;
-            case 'b': /*decrease boundary_av*/
-                if (BOUNDARY_AV_W - boundary_av_st > 0) BOUNDARY_AV_W -= boundary_av_st;
-                break;
-            case 'S': /*increase separation*/
-                SEPARATION_W += separation_st;
-                break;
-            case 's': /*decrease separation*/
-                if (SEPARATION_W - separation_st > 0) SEPARATION_W -= separation_st;
-                break;
-            case 'C': /*increase cohesion*/
-                COHESION_W += cohesion_st;
-                break;
-            case 'c': /*decrease cohesion*/
-                if (COHESION_W - cohesion_st > 0) COHESION_W -= cohesion_st;
-                break;
-            case 'A': /*increase alignment*/
-                ALIGNMENT_W += alignment_st;
-                break;
-            case 'a': /*decrease alignment*/
-                if (ALIGNMENT_W - alignment_st > 0) ALIGNMENT_W -= alignment_st;
-                break;
-            case 'R': /*increase frame rate*/
-                FRAME_RATE += frame_rate_st;
-                break;
-            case 'r': /*decrease frame rate*/
-                if (FRAME_RATE - frame_rate_st > 0) FRAME_RATE -= frame_rate_st;
-                break;
-            case 'P': /*increase perception radius*/
-                PERCEPTION_RADIUS += perception_radius_st;
-                PERCEPTION_RADIUS_SQUARED = PERCEPTION_RADIUS * PERCEPTION_RADIUS;
-                break;
-            case 'p': /*decrease perception radius*/
-                if (PERCEPTION_RADIUS - perception_radius_st > 0) {
-                    PERCEPTION_RADIUS -= perception_radius_st;
-                    PERCEPTION_RADIUS_SQUARED = PERCEPTION_RADIUS * PERCEPTION_RADIUS;
-                }
-                break;
+        if (daemon_fd >= 0 && c != 'q' && c != '=' && c != '-') {
+            /*Queued, the socket may be full: flushed again on POLLOUT*/
+            if (forward_keys_n < INPUT_BUF_DIM) forward_keys[forward_keys_n++] = c;
+            if (flush_keys(daemon_fd) < 0) {
+                perror("Viewer write");
+                exit(-1);
+            }
+            return;
+        }
+        apply_key(c, images_data);
+    }
+}
+
+/*Writes the queued keys to the daemon, returns the bytes still queued or -1 on error*/
+int flush_keys(int daemon_fd) {
+    while (forward_keys_n > 0) {
+        ssize_t n = write(daemon_fd, forward_keys, forward_keys_n);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EPIPE) exit(0); /*Daemon has gone*/
+            return -1;
         }
+        memmove(forward_keys, forward_keys + n, forward_keys_n - n);
+        forward_keys_n -= n;
+    }
+    return forward_keys_n;
+}
+
+/*Applies a single key, images_data is NULL when there are no sprites (daemon, text)*/
+void apply_key(char c, uint8_t **images_data) {
+    switch (c) {
+        case 'q': /*quit*/
+            if (run_mode == DAEMON) break; /*Viewers can't stop the daemon*/
+            my_atexit();
+            exit(0);
+            break;
+        case '=': /*increase bird image size*/
+            if (images_data && BIRD_SIZE < IMAGE_SIZES + BASE_IMAGE_SIZE - 1)
+                change_birds_dimensions(true, images_data);
+            break;
+        case '-': /*decrease bird image size*/
+            if (images_data && BIRD_SIZE > BASE_IMAGE_SIZE)
+                change_birds_dimensions(false, images_data);
+            break;
+        case 'B': /*increase boundary_av*/
+            BOUNDARY_AV_W += boundary_av_st;
+            break;
+        case 'b': /*decrease boundary_av*/
+            if (BOUNDARY_AV_W - boundary_av_st > 0) BOUNDARY_AV_W -= boundary_av_st;
+            break;
+        case 'S': /*increase separation*/
+            SEPARATION_W += separation_st;
+            break;
+        case 's': /*decrease separation*/
+            if (SEPARATION_W - separation_st > 0) SEPARATION_W -= separation_st;
+            break;
+        case 'C': /*increase cohesion*/
+            COHESION_W += cohesion_st;
+            break;
+        case 'c': /*decrease cohesion*/
+            if (COHESION_W - cohesion_st > 0) COHESION_W -= cohesion_st;
+            break;
+        case 'A': /*increase alignment*/
+            ALIGNMENT_W += alignment_st;
+            break;
+        case 'a': /*decrease alignment*/
+            if (ALIGNMENT_W - alignment_st > 0) ALIGNMENT_W -= alignment_st;
+            break;
+        case 'R': /*increase frame rate*/
+            FRAME_RATE += frame_rate_st;
+            break;
+        case 'r': /*decrease frame rate*/
+            if (FRAME_RATE - frame_rate_st > 0) FRAME_RATE -= frame_rate_st;
+            break;
+        case 'P': /*increase perception radius*/
+            PERCEPTION_RADIUS += perception_radius_st;
+            PERCEPTION_RADIUS_SQUARED = PERCEPTION_RADIUS * PERCEPTION_RADIUS;
+            break;
+        case 'F': /*increase flee*/
+            FLEE_W += flee_st;
+            break;
+        case 'f': /*decrease flee*/
+            if (FLEE_W - flee_st > 0) FLEE_W -= flee_st;
+            break;
+        case 'N': /*add birds*/
+            add_birds(birds_st);
+            break;
+        case 'n': /*remove birds*/
+            remove_birds(birds_st);
+            break;
+        case 'M': /*add many birds*/
+            add_birds(birds_big_st);
+            break;
+        case 'm': /*remove many birds*/
+            remove_birds(birds_big_st);
+            break;
+        case 'p': /*decrease perception radius*/
+            if (PERCEPTION_RADIUS - perception_radius_st > 0) {
+                PERCEPTION_RADIUS -= perception_radius_st;
+                PERCEPTION_RADIUS_SQUARED = PERCEPTION_RADIUS * PERCEPTION_RADIUS;
+            }
+            break;
     }
 }
 
@@ -709,6 +1481,36 @@ void read_input(int argc, char **argv) {
                 FRAME_RATE = (int)arg;
                 SPEED = DEF_SPEED * (double)DEF_FRAME_RATE / FRAME_RATE;
                 if (SPEED == 0) SPEED = 1;
+            } else if (strcmp(*argv, "-k") == 0) { /*predators number flag*/
+                argv++;
+                argc--;
+                long arg = strtol(*argv, NULL, 10);
+                if (errno == ERANGE || arg < 0) {
+                    perror("Invalid arguments for predators num");
+                    exit(-1);
+                }
+                PREDATORS_N = (int)arg;
+            } else if (strcmp(*argv, "-r") == 0) { /*renderer: kitty or text*/
+                argv++;
+                argc--;
+                if (strcmp(*argv, "text") == 0) {
+                    renderer = TEXT;
+                } else if (strcmp(*argv, "kitty") == 0) {
+                    renderer = KITTY;
+                } else {
+                    fprintf(stderr, "Invalid renderer %s, expected kitty or text\n", *argv);
+                    exit(-1);
+                }
+            } else if (strcmp(*argv, "-d") == 0) { /*headless daemon socket path*/
+                argv++;
+                argc--;
+                run_mode = DAEMON;
+                socket_path = *argv;
+            } else if (strcmp(*argv, "-v") == 0) { /*viewer of the daemon at socket path*/
+                argv++;
+                argc--;
+                run_mode = VIEWER;
+                socket_path = *argv;
             }
 
             else
@@ -719,46 +1521,457 @@ void read_input(int argc, char **argv) {
     }
 }
 
-void refresh_screen(char **output_buf, drawn_bird_t **draw_birds, bird_t **birds,
-                    bird_t **birds_copy) {
-    for (int i = 0; i < BIRDS_N; i++) print_bird(draw_birds, i, *output_buf);
+void refresh_screen(char **output_buf, size_t *output_buf_cap) {
+    reserve_output(output_buf, output_buf_cap, BIRDS_N + PREDATORS_N);
+    begin_frame(*output_buf);
+    for (int i = 0; i < BIRDS_N; i++) print_bird(flock.draw_birds, i, *output_buf);
+    for (int i = 0; i < PREDATORS_N; i++) {
+        drawn_bird_t *predator = draw_predators[i];
+        draw(predator->bird_ref->x, predator->bird_ref->y, predator->curr_id, true, BIRDS_N + i,
+             *output_buf);
+    }
+    simulate(flock.draw_birds, flock.birds, flock.birds_copy);
+    end_frame(*output_buf);
+}
+
+/*Grows the output buffer to hold the escapes of records_num birds*/
+void reserve_output(char **output_buf, size_t *output_buf_cap, size_t records_num) {
+    size_t needed = (size_t)OUTPUT_BUF_BIRD * (records_num + 1);
+
+    if (*output_buf_cap < needed) {
+        if (needed < *output_buf_cap * 2) needed = *output_buf_cap * 2;
+        *output_buf = (char *)realloc(*output_buf, needed);
+        *output_buf_cap = needed;
+    }
+}
+
+/*Advances the simulation by one frame*/
+void simulate(drawn_bird_t **draw_birds, bird_t **birds, bird_t **birds_copy) {
     copy(birds, birds_copy, BIRDS_N);
-    update_rotation_frame_id(draw_birds);
+    copy(predators, predators_copy, PREDATORS_N);
+    update_rotation_frame_id(draw_birds, BIRDS_N);
+    update_rotation_frame_id(draw_predators, PREDATORS_N);
+    build_predator_index(predators_copy, PREDATORS_N);
     update_birds(birds_copy, birds, screen_width, screen_heigth, BIRDS_N);
-    clean_screen();
-    fflush(stdout);
-    write(STDOUT_FILENO, *output_buf, output_buf_off);
-    output_buf_off = 0;
+    update_predators(birds_copy, BIRDS_N, predators, PREDATORS_N);
+}
+
+/*========================Headless daemon and viewers==========================
+ *
+ * The daemon runs the flock without a terminal and publishes every frame on a
+ * unix socket. A frame is a compact binary snapshot of every bird (world
+ * position and rotation frame id), little endian:
+ *
+ *     magic(u32) seq(u32) world_width(u16) world_heigth(u16) birds_n(u32)
+ *     predators_n(u32)
+ *     (birds_n + predators_n) * { x(i16) y(i16) rotation_frame_id(u8) }
+ *
+ * Predators records follow the birds ones. Frames are full snapshots rather
+ * than deltas: any frame can be rendered alone, so a viewer that skips frames
+ * resyncs with the next one it gets, without keyframes.
+ *
+ * Frames are encoded once in a ring and written from there to every viewer
+ * without copies. Viewer sockets are non blocking: a viewer that can't keep up
+ * keeps its frame referenced until it's written, and once the ring has lapped
+ * it skips to the newest one, so it never holds up the simulation or the other
+ * viewers. Viewers scale world coordinates to their own terminal and render
+ * Kitty escapes locally.
+ *
+ * Every client byte is a key, except the VIEWER_HELLO a viewer opens with to
+ * receive frames: clients that never send it only control the simulation. */
+
+void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xffff);
+    put_u16(p + 2, v >> 16);
+}
+
+uint16_t get_u16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+uint32_t get_u32(const uint8_t *p) {
+    return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+int16_t clamp_i16(double v) {
+    if (v < INT16_MIN) return INT16_MIN;
+    if (v > INT16_MAX) return INT16_MAX;
+    return (int16_t)v;
+}
+
+uint8_t *encode_records(uint8_t *p, drawn_bird_t **draw_birds, int birds_num) {
+    for (int i = 0; i < birds_num; i++) {
+        put_u16(p, clamp_i16(draw_birds[i]->bird_ref->x));
+        put_u16(p + 2, clamp_i16(draw_birds[i]->bird_ref->y));
+        p[4] = draw_birds[i]->curr_id;
+        p += FRAME_RECORD_LEN;
+    }
+    return p;
+}
+
+void encode_frame(frame_t *frame, drawn_bird_t **draw_birds) {
+    size_t len = FRAME_HEADER_LEN + (size_t)FRAME_RECORD_LEN * (BIRDS_N + PREDATORS_N);
+    uint8_t *p;
+
+    if (frame->cap < len) {
+        frame->data = (uint8_t *)realloc(frame->data, len);
+        frame->cap = len;
+    }
+    p = frame->data;
+    put_u32(p, FRAME_MAGIC);
+    put_u32(p + 4, frame->seq);
+    put_u16(p + 8, screen_width);
+    put_u16(p + 10, screen_heigth);
+    put_u32(p + 12, BIRDS_N);
+    put_u32(p + 16, PREDATORS_N);
+    p = encode_records(p + FRAME_HEADER_LEN, draw_birds, BIRDS_N);
+    encode_records(p, draw_predators, PREDATORS_N);
+    frame->len = len;
+}
+
+/*Encodes the current state in the next ring slot, dropping the ring reference
+ * to the oldest frame*/
+void publish_frame(drawn_bird_t **draw_birds) {
+    frame_t *frame = free_frames;
+    frame_t **slot = &frame_ring[frame_seq % FRAME_RING];
+
+    if (frame)
+        free_frames = frame->next;
+    else
+        frame = (frame_t *)calloc(1, sizeof(frame_t));
+    frame->seq = frame_seq;
+    frame->refs = 1; /*Ring reference*/
+    encode_frame(frame, draw_birds);
+    if (*slot) release_frame(*slot);
+    *slot = frame;
+    frame_seq++;
+}
+
+void release_frame(frame_t *frame) {
+    if (--frame->refs == 0) {
+        frame->next = free_frames;
+        free_frames = frame;
+    }
+}
+
+/*Next frame to be sent to viewer, NULL if it's up to date*/
+frame_t *next_frame(viewer_t *viewer) {
+    if (!viewer->frames) return NULL;
+    if (viewer->next_seq >= frame_seq) return NULL;
+    if (frame_seq - viewer->next_seq > FRAME_RING) viewer->next_seq = frame_seq - 1;
+    return frame_ring[viewer->next_seq % FRAME_RING];
+}
+
+/*Writes pending frames until the viewer socket is full, returns -1 on error*/
+int flush_viewer(viewer_t *viewer) {
+    ssize_t n;
+
+    while (1) {
+        if (viewer->frame == NULL) {
+            viewer->frame = next_frame(viewer);
+            if (viewer->frame == NULL) return 0;
+            viewer->frame->refs++;
+            viewer->off = 0;
+        }
+        n = write(viewer->fd, viewer->frame->data + viewer->off, viewer->frame->len - viewer->off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        viewer->off += n;
+        if (viewer->off == viewer->frame->len) {
+            viewer->next_seq = viewer->frame->seq + 1;
+            release_frame(viewer->frame);
+            viewer->frame = NULL;
+        }
+    }
+}
+
+/*Applies keys forwarded by the viewer, returns -1 once it has disconnected*/
+int read_viewer_input(viewer_t *viewer) {
+    char input_buf[INPUT_BUF_DIM];
+    ssize_t size;
+
+    while ((size = read(viewer->fd, input_buf, INPUT_BUF_DIM)) > 0) {
+        for (ssize_t i = 0; i < size; i++) {
+            if (input_buf[i] == VIEWER_HELLO && !viewer->frames) {
+                /*New viewers start from the newest frame*/
+                viewer->frames = true;
+                viewer->next_seq = frame_seq > 0 ? frame_seq - 1 : 0;
+            } else {
+                apply_key(input_buf[i], NULL);
+            }
+        }
+    }
+    if (size == 0) return -1;
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+}
+
+int set_non_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int open_server_socket(const char *path) {
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    /*Removes a stale socket, but never a regular file nor a live daemon socket*/
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            errno = EEXIST;
+            return -1;
+        }
+        fd = connect_daemon(path);
+        if (fd >= 0) {
+            close(fd);
+            errno = EADDRINUSE;
+            return -1;
+        }
+        if (errno != ECONNREFUSED) return -1;
+        unlink(path);
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, MAX_VIEWERS) < 0 ||
+        set_non_blocking(fd) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connect_daemon(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || set_non_blocking(fd) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void accept_viewers(int listen_fd) {
+    int fd;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+        if (viewers_n == MAX_VIEWERS || set_non_blocking(fd) < 0) {
+            close(fd);
+            continue;
+        }
+        viewers[viewers_n].fd = fd;
+        viewers[viewers_n].frame = NULL;
+        viewers[viewers_n].off = 0;
+        viewers[viewers_n].next_seq = 0;
+        viewers[viewers_n].frames = false;
+        viewers_n++;
+    }
+}
+
+void drop_viewer(int viewer_no) {
+    viewer_t *viewer = &viewers[viewer_no];
+    close(viewer->fd);
+    if (viewer->frame) release_frame(viewer->frame);
+    viewers[viewer_no] = viewers[--viewers_n];
+}
+
+void stop_daemon(int signo) {
+    (void)signo;
+    daemon_running = 0;
+}
+
+/*Keys written by any client on the socket control the daemon, e.g. N/n resize the flock*/
+void run_daemon() {
+    int listen_fd = open_server_socket(socket_path);
+    if (listen_fd < 0) {
+        perror("Can't open daemon socket");
+        exit(-1);
+    }
+    signal(SIGPIPE, SIG_IGN); /*Disconnected viewers are handled as write errors*/
+    signal(SIGINT, stop_daemon);
+    signal(SIGTERM, stop_daemon);
+
+    while (daemon_running) {
+        accept_viewers(listen_fd);
+        publish_frame(flock.draw_birds);
+        simulate(flock.draw_birds, flock.birds, flock.birds_copy);
+        for (int i = 0; i < viewers_n;) {
+            if (read_viewer_input(&viewers[i]) < 0 || flush_viewer(&viewers[i]) < 0)
+                drop_viewer(i);
+            else
+                i++;
+        }
+        usleep(1000000 / FRAME_RATE);
+    }
+    while (viewers_n > 0) drop_viewer(0);
+    close(listen_fd);
+    unlink(socket_path);
+}
+
+/* Draws a received frame scaling the daemon world to the current screen.
+ * Both axes share the same scale, so headings (and the rotation frame ids
+ * computed from them) are preserved, the spare space is letterboxed.*/
+void render_frame(const uint8_t *frame, char **output_buf, size_t *output_buf_cap) {
+    double world_width = get_u16(frame + 8);
+    double world_heigth = get_u16(frame + 10);
+    uint32_t birds_n = get_u32(frame + 12);
+    uint32_t records_n = birds_n + get_u32(frame + 16);
+    double scale, off_x, off_y;
+
+    reserve_output(output_buf, output_buf_cap, records_n);
+    get_screen_dimensions();
+    scale = fmin(screen_width / world_width, screen_heigth / world_heigth);
+    off_x = (screen_width - world_width * scale) / 2;
+    off_y = (screen_heigth - world_heigth * scale) / 2;
+    begin_frame(*output_buf);
+    frame += FRAME_HEADER_LEN;
+    for (uint32_t i = 0; i < records_n; i++) {
+        double x = off_x + (int16_t)get_u16(frame) * scale;
+        double y = off_y + (int16_t)get_u16(frame + 2) * scale;
+        draw(x, y, frame[4] % ROTATION_FRAME, i >= birds_n, i, *output_buf);
+        frame += FRAME_RECORD_LEN;
+    }
+    end_frame(*output_buf);
+}
+
+void run_viewer(uint8_t **images_data) {
+    uint8_t *recv_buf = NULL;
+    size_t recv_len = 0, recv_cap = 0;
+    char *output_buf = NULL;
+    size_t output_buf_cap = 0;
+    struct pollfd fds[3];
+    int fd = connect_daemon(socket_path);
+    char hello = VIEWER_HELLO;
+
+    if (fd < 0 || write(fd, &hello, 1) != 1) {
+        perror("Can't connect to daemon");
+        exit(-1);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    fds[0].fd = fd;
+    fds[1].fd = STDIN_FILENO;
+    fds[1].events = POLLIN;
+    fds[2].fd = STDOUT_FILENO;
+
+    while (1) {
+        fds[0].events = POLLIN | (forward_keys_n > 0 ? POLLOUT : 0);
+        fds[2].events = out_flush() > 0 ? POLLOUT : 0;
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Viewer poll");
+            exit(-1);
+        }
+        if ((fds[0].revents & POLLOUT) && flush_keys(fd) < 0) {
+            perror("Viewer write");
+            exit(-1);
+        }
+        if (fds[1].revents & POLLIN) handle_key(images_data, fd);
+        if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        /*Drains the socket, then draws only the newest complete frame*/
+        while (1) {
+            ssize_t n;
+            if (recv_cap - recv_len < INPUT_BUF_DIM * 64) {
+                recv_cap = recv_cap * 2 + INPUT_BUF_DIM * 64;
+                recv_buf = (uint8_t *)realloc(recv_buf, recv_cap);
+            }
+            n = read(fd, recv_buf + recv_len, recv_cap - recv_len);
+            if (n > 0) {
+                recv_len += n;
+                continue;
+            }
+            if (n == 0) exit(0); /*Daemon has gone*/
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            perror("Viewer read");
+            exit(-1);
+        }
+
+        size_t off = 0, newest = 0, frame_len = 0;
+        bool complete = false;
+        while (recv_len - off >= FRAME_HEADER_LEN) {
+            if (get_u32(recv_buf + off) != FRAME_MAGIC) {
+                fprintf(stderr, "Corrupted frame stream\n");
+                exit(-1);
+            }
+            frame_len = FRAME_HEADER_LEN + (size_t)FRAME_RECORD_LEN * (get_u32(recv_buf + off + 12) +
+                                                                       get_u32(recv_buf + off + 16));
+            if (recv_len - off < frame_len) break;
+            newest = off;
+            complete = true;
+            off += frame_len;
+        }
+        if (complete) render_frame(recv_buf + newest, &output_buf, &output_buf_cap);
+        memmove(recv_buf, recv_buf + off, recv_len - off);
+        recv_len -= off;
+    }
 }
 
 int main(int argc, char *argv[]) {
     read_input(argc, argv); /*Reads cli input data*/
     get_screen_dimensions();
-    if (my_atenter() < 0) { /*Try to enable terminal raw mode*/
-        perror("Can't enable raw mode :");
-        exit(-1);
+    if (run_mode != DAEMON) {
+        if (my_atenter() < 0) { /*Try to enable terminal raw mode*/
+            perror("Can't enable raw mode :");
+            exit(-1);
+        }
+        atexit(my_atexit); /*Defines exit callback*/
+        clear();
+        if (renderer == TEXT) out_write("\033[?25l", strlen("\033[?25l")); /*Hides cursor*/
     }
-    atexit(my_atexit); /*Defines exit callback*/
-    clear();
-    char *output_buf;
-    int output_buf_len;
+    char *output_buf = NULL;
+    size_t output_buf_cap = 0;
     uint8_t *images_data[ROTATION_FRAME * IMAGE_SIZES];
-    drawn_bird_t *draw_birds[BIRDS_N];
-    bird_t *birds[BIRDS_N];
-    bird_t *birds_copy[BIRDS_N];
+    bool sprites = run_mode != DAEMON && renderer == KITTY;
 
-    init(&output_buf, images_data, draw_birds, birds, birds_copy);
-    send_payload_data(images_data); /*Sends png images data base64 encoded*/
+    if (run_mode == VIEWER) {
+        if (sprites) {
+            init_rotation_frames(images_data);
+            send_payload_data(images_data);
+        }
+        run_viewer(sprites ? images_data : NULL);
+    }
+
+    init(sprites ? images_data : NULL);
+    if (run_mode == DAEMON) {
+        run_daemon();
+        return 0;
+    }
+    if (sprites) send_payload_data(images_data); /*Sends png images data base64 encoded*/
 
     while (1) {
         /*Refresh screen*/
         get_screen_dimensions();
-        refresh_screen(&output_buf, draw_birds, birds, birds_copy);
+        refresh_screen(&output_buf, &output_buf_cap);
 
         /*Handles input*/
-        handle_key(images_data);
+        handle_key(sprites ? images_data : NULL, -1);
 
         /*Sleeps to comply frame rate*/
-        usleep(1000000 / FRAME_RATE);
+        wait_frame(1000000 / FRAME_RATE);
     }
 }